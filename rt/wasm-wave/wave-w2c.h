@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <limits.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -86,6 +87,60 @@ u32 w2c_wave_fs_avail(struct w2c_wave* w, u32 fd) {
   return (u32)n;
 }
   
+#define W2C_WAVE_IOV_MAX 64
+
+// Gather {len} pairs of (ptr, len) u32s at {iovs} in linear memory into {iov}.
+static int w2c_wave_iovecs(struct w2c_wave* w, u32 iovs, u32 len, struct iovec* iov) {
+  if (len > W2C_WAVE_IOV_MAX) return -1;
+  for (u32 i = 0; i < len; i++) {
+    u32 pair[2];
+    memcpy(pair, w->memory->data + iovs + i * 8, 8);
+    iov[i].iov_base = w->memory->data + pair[0];
+    iov[i].iov_len = pair[1];
+  }
+  return (int)len;
+}
+
+/* import: 'wave' 'fs_readv' */
+u32 w2c_wave_fs_readv(struct w2c_wave* w, u32 fd, u32 iovs, u32 len) {
+  struct iovec iov[W2C_WAVE_IOV_MAX];
+  if (w2c_wave_iovecs(w, iovs, len, iov) < 0) return (u32)-1;
+  return readv(fd, iov, len);
+}
+
+/* import: 'wave' 'fs_writev' */
+u32 w2c_wave_fs_writev(struct w2c_wave* w, u32 fd, u32 iovs, u32 len) {
+  struct iovec iov[W2C_WAVE_IOV_MAX];
+  if (w2c_wave_iovecs(w, iovs, len, iov) < 0) return (u32)-1;
+  return writev(fd, iov, len);
+}
+
+/* import: 'wave' 'fs_pread' */
+u32 w2c_wave_fs_pread(struct w2c_wave* w, u32 fd, u32 ptr, u32 len, u32 offset) {
+  uint8_t* base = w->memory->data + ptr;
+  return pread(fd, base, len, offset);
+}
+
+/* import: 'wave' 'fs_pwrite' */
+u32 w2c_wave_fs_pwrite(struct w2c_wave* w, u32 fd, u32 ptr, u32 len, u32 offset) {
+  uint8_t* base = w->memory->data + ptr;
+  return pwrite(fd, base, len, offset);
+}
+
+/* import: 'wave' 'fs_mmap' */
+u32 w2c_wave_fs_mmap(struct w2c_wave* w, u32 fd, u32 ptr, u32 len, u32 offset) {
+  // Reads until the buffer is full or the file ends; the copy comes straight from the page cache.
+  uint8_t* base = w->memory->data + ptr;
+  u32 total = 0;
+  while (total < len) {
+    ssize_t r = pread(fd, base + total, len - total, offset + total);
+    if (r < 0) return (u32)-1;
+    if (r == 0) break;
+    total += (u32)r;
+  }
+  return total;
+}
+
 /* import: 'wave' 'fs_close' */
 void w2c_wave_fs_close(struct w2c_wave* w, u32 fd) {
   close(fd);
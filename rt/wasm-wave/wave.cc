@@ -1,10 +1,14 @@
 #include <iostream>
-#include <fstream>
 #include <cstdlib>
 #include <string>
 #include <cinttypes>
+#include <cstring>
+#include <unordered_map>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -77,8 +81,10 @@ struct instance_fds {
 };
 
 #define MAXPATH 1024
+#define IOV_MAX_WAVE 64
 
 bool global_trace;
+bool global_cache = true;
 char* global_filename;
 instance_fds global_fds;
 uint8_t global_pathbuf[MAXPATH + 1];
@@ -136,6 +142,154 @@ bool name_eq(const char* name, size_t name_len, const wasm::Name& val) {
   return (val.size() == name_len) && (strncmp(name, val.get(), name_len) == 0);
 }
 
+//============================================================================
+// Loading of module binaries, with a cache of compiled modules on disk.
+//============================================================================
+struct mapped_file {
+  const byte_t* data = nullptr;
+  size_t size = 0;
+
+  bool map(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat s;
+    if (fstat(fd, &s) != 0 || s.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+    void* p = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    data = reinterpret_cast<const byte_t*>(p);
+    size = static_cast<size_t>(s.st_size);
+    return true;
+  }
+
+  void unmap() {
+    if (data) munmap(const_cast<byte_t*>(data), size);
+    data = nullptr;
+    size = 0;
+  }
+};
+
+// A cached module is this header, followed by the bytes of {Module::serialize}.
+struct cache_header {
+  char magic[8];
+  uint64_t hash;  // hash of the module binary
+  uint64_t size;  // size of the module binary
+};
+
+const char CACHE_MAGIC[8] = {'W', 'A', 'V', 'E', 'M', 'O', 'D', '1'};
+
+// FNV-1a hash of the module binary.
+uint64_t content_hash(const byte_t* data, size_t size) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    h ^= static_cast<uint8_t>(data[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// Get the cache directory, creating it if necessary, or an empty string if there is none.
+std::string cache_dir() {
+  const char* dir = getenv("WAVE_CACHE_DIR");
+  if (dir) return dir;
+  std::string parent;
+  const char* xdg = getenv("XDG_CACHE_HOME");
+  const char* home = getenv("HOME");
+  if (xdg) parent = xdg;
+  else if (home) parent = std::string(home) + "/.cache";
+  else return "";
+  mkdir(parent.c_str(), 0755);
+  std::string result = parent + "/wave";
+  mkdir(result.c_str(), 0755);
+  return result;
+}
+
+std::string cache_path(uint64_t hash, size_t size) {
+  auto dir = cache_dir();
+  if (dir.empty()) return dir;
+  char name[64];
+  snprintf(name, sizeof(name), "/%016" PRIx64 "-%zu.wcm", hash, size);
+  return dir + name;
+}
+
+wasm::own<wasm::Module*> load_cached_module(wasm::Store* store, const std::string& path,
+                                           uint64_t hash, size_t size) {
+  mapped_file cached;
+  if (!cached.map(path.c_str())) return wasm::own<wasm::Module*>();
+  wasm::own<wasm::Module*> module;
+  cache_header header;
+  if (cached.size > sizeof(header)) {
+    memcpy(&header, cached.data, sizeof(header));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+        header.hash == hash && header.size == size) {
+      auto serialized = wasm::vec<byte_t>::make_uninitialized(cached.size - sizeof(header));
+      memcpy(serialized.get(), cached.data + sizeof(header), serialized.size());
+      // The engine rejects modules serialized by a different version of itself.
+      module = wasm::Module::deserialize(store, serialized);
+    }
+  }
+  cached.unmap();
+  if (module) TRACE("Loaded cached module %s\n", path.c_str());
+  return module;
+}
+
+bool write_fully(int fd, const void* data, size_t size) {
+  auto p = reinterpret_cast<const char*>(data);
+  while (size > 0) {
+    auto result = ::write(fd, p, size);
+    if (result <= 0) return false;
+    p += result;
+    size -= result;
+  }
+  return true;
+}
+
+// Write the cached module to a temporary file and rename it, so that concurrent
+// processes never see a partially written module.
+void store_cached_module(const std::string& path, uint64_t hash, size_t size,
+                         const wasm::Module* module) {
+  auto serialized = module->serialize();
+  if (serialized.size() == 0) return;
+  cache_header header;
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.hash = hash;
+  header.size = size;
+  auto tmp = path + ".tmp." + std::to_string(getpid());
+  int fd = ::open(tmp.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (fd < 0) return;
+  bool ok = write_fully(fd, &header, sizeof(header)) &&
+            write_fully(fd, serialized.get(), serialized.size());
+  ok = (::close(fd) == 0) && ok;
+  if (ok && rename(tmp.c_str(), path.c_str()) == 0) {
+    TRACE("Stored cached module %s\n", path.c_str());
+  } else {
+    unlink(tmp.c_str());
+  }
+}
+
+// Load the compiled module for {binary} from the cache, or compile it and add it to the cache.
+wasm::own<wasm::Module*> load_module(wasm::Store* store, const mapped_file& binary) {
+  std::string path;
+  uint64_t hash = 0;
+  if (global_cache) {
+    hash = content_hash(binary.data, binary.size);
+    path = cache_path(hash, binary.size);
+    if (!path.empty()) {
+      auto module = load_cached_module(store, path, hash, binary.size);
+      if (module) return module;
+    }
+  }
+  TRACE("Compiling module...\n");
+  auto bytes = wasm::vec<byte_t>::make_uninitialized(binary.size);
+  memcpy(bytes.get(), binary.data, binary.size);
+  auto module = wasm::Module::make(store, bytes);
+  if (module && !path.empty()) store_cached_module(path, hash, binary.size, module.get());
+  return module;
+}
+
 //============================================================================
 // Wave functions that can be imported into a module.
 //============================================================================
@@ -244,13 +398,168 @@ WAVE_FUNC(fs_avail) {
 
   int sys_fd = fds->get_sys_fd(fd);
   if (sys_fd < 0) { RETURN_MINUS_1; }
-  auto cur = lseek(sys_fd, 0, SEEK_CUR);
-  auto avail = lseek(sys_fd, 0, SEEK_END) - cur;
-  lseek(sys_fd, cur, SEEK_SET);
+  struct stat s;
+  if (fstat(sys_fd, &s) != 0) { RETURN_MINUS_1; }
+  int64_t avail = 0;
+  if (S_ISREG(s.st_mode)) {
+    auto cur = lseek(sys_fd, 0, SEEK_CUR);
+    if (cur < 0) { RETURN_MINUS_1; }
+    avail = s.st_size > cur ? s.st_size - cur : 0;
+  } else {
+    int n = 0;
+    if (ioctl(sys_fd, FIONREAD, &n) == 0) avail = n;
+  }
   results[0] = wasm::Val::i32(static_cast<int32_t>(avail));
   return nullptr;
 }
 
+// Gather an array of {buffer, length} pairs of i32s in linear memory into {iov}.
+// Returns the number of entries, or -1 if any buffer is out of bounds.
+int checkiovec(int32_t iovs, int32_t iovs_len, struct iovec* iov) {
+  if (iovs_len < 0 || iovs_len > IOV_MAX_WAVE) return -1;
+  auto pairs = reinterpret_cast<int32_t*>(checkbuffer(iovs, iovs_len * 8));
+  if (!pairs) return -1;
+  for (int32_t i = 0; i < iovs_len; i++) {
+    int32_t buf, len;
+    memcpy(&buf, &pairs[i * 2], 4);
+    memcpy(&len, &pairs[i * 2 + 1], 4);
+    void* buffer = checkbuffer(buf, len);
+    if (!buffer) return -1;
+    iov[i].iov_base = buffer;
+    iov[i].iov_len = len;
+  }
+  return iovs_len;
+}
+
+WAVE_FUNC(fs_readv) {
+  instance_fds* fds = &global_fds;
+  ARG(0, fd, i32);
+  ARG(1, iovs, i32);
+  ARG(2, iovs_len, i32);
+
+  TRACE("fs_readv(fd=%d, iovs=0x%08x, len=%d)\n", fd, iovs, iovs_len);
+
+  int sys_fd = fds->get_sys_fd(fd);
+  struct iovec iov[IOV_MAX_WAVE];
+  if (sys_fd < 0 || checkiovec(iovs, iovs_len, iov) < 0) { RETURN_MINUS_1; }
+  int32_t result = ::readv(sys_fd, iov, iovs_len);
+  results[0] = wasm::Val::i32(result);
+  return nullptr;
+}
+
+WAVE_FUNC(fs_writev) {
+  instance_fds* fds = &global_fds;
+  ARG(0, fd, i32);
+  ARG(1, iovs, i32);
+  ARG(2, iovs_len, i32);
+
+  TRACE("fs_writev(fd=%d, iovs=0x%08x, len=%d)\n", fd, iovs, iovs_len);
+
+  int sys_fd = fds->get_sys_fd(fd);
+  struct iovec iov[IOV_MAX_WAVE];
+  if (sys_fd < 0 || checkiovec(iovs, iovs_len, iov) < 0) { RETURN_MINUS_1; }
+  int32_t result = ::writev(sys_fd, iov, iovs_len);
+  results[0] = wasm::Val::i32(result);
+  return nullptr;
+}
+
+WAVE_FUNC(fs_pread) {
+  instance_fds* fds = &global_fds;
+  ARG(0, fd, i32);
+  ARG(1, buf, i32);
+  ARG(2, buf_len, i32);
+  ARG(3, offset, i32);
+
+  TRACE("fs_pread(fd=%d, buf=0x%08x, len=%d, offset=%d)\n", fd, buf, buf_len, offset);
+
+  int sys_fd = fds->get_sys_fd(fd);
+  void* buffer = checkbuffer(buf, buf_len);
+  if (sys_fd < 0 || !buffer || offset < 0) { RETURN_MINUS_1; }
+  int32_t result = ::pread(sys_fd, buffer, buf_len, offset);
+  results[0] = wasm::Val::i32(result);
+  return nullptr;
+}
+
+WAVE_FUNC(fs_pwrite) {
+  instance_fds* fds = &global_fds;
+  ARG(0, fd, i32);
+  ARG(1, buf, i32);
+  ARG(2, buf_len, i32);
+  ARG(3, offset, i32);
+
+  TRACE("fs_pwrite(fd=%d, buf=0x%08x, len=%d, offset=%d)\n", fd, buf, buf_len, offset);
+
+  int sys_fd = fds->get_sys_fd(fd);
+  void* buffer = checkbuffer(buf, buf_len);
+  if (sys_fd < 0 || !buffer || offset < 0) { RETURN_MINUS_1; }
+  int32_t result = ::pwrite(sys_fd, buffer, buf_len, offset);
+  results[0] = wasm::Val::i32(result);
+  return nullptr;
+}
+
+// Read {len} bytes at {offset} of a file into {buffer}, retrying short reads.
+int64_t pread_fully(int sys_fd, uint8_t* buffer, int64_t len, int64_t offset) {
+  int64_t total = 0;
+  while (total < len) {
+    auto r = ::pread(sys_fd, buffer + total, len - total, offset + total);
+    if (r < 0) return -1;
+    if (r == 0) break;
+    total += r;
+  }
+  return total;
+}
+
+// Fills a region of linear memory with the contents of a file, starting at {offset}.
+// The whole pages of the region that line up with pages of the file are mapped privately
+// over linear memory, so that they are read lazily from the page cache without a copy;
+// writes to them stay in the instance and never reach the file. The unaligned head and
+// tail of the region, and regions that cannot be mapped, are read with {pread}.
+// Mapped pages that have not been written are still backed by the file, so truncating the
+// file later makes reading them raise SIGBUS, and rewriting it in place changes them.
+WAVE_FUNC(fs_mmap) {
+  instance_fds* fds = &global_fds;
+  ARG(0, fd, i32);
+  ARG(1, buf, i32);
+  ARG(2, buf_len, i32);
+  ARG(3, offset, i32);
+
+  TRACE("fs_mmap(fd=%d, buf=0x%08x, len=%d, offset=%d)\n", fd, buf, buf_len, offset);
+
+  int sys_fd = fds->get_sys_fd(fd);
+  auto buffer = reinterpret_cast<uint8_t*>(checkbuffer(buf, buf_len));
+  if (sys_fd < 0 || !buffer || offset < 0) { RETURN_MINUS_1; }
+
+  struct stat s;
+  if (fstat(sys_fd, &s) != 0) { RETURN_MINUS_1; }
+  int64_t len = buf_len;
+  if (S_ISREG(s.st_mode)) {
+    int64_t left = s.st_size > offset ? s.st_size - offset : 0;
+    if (len > left) len = left;
+  }
+
+  uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t start = reinterpret_cast<uintptr_t>(buffer);
+  int64_t head = static_cast<int64_t>(((start + page - 1) & ~(page - 1)) - start);
+  int64_t pages = head < len ? static_cast<int64_t>((len - head) & ~(page - 1)) : 0;
+  bool aligned = ((offset + head) & (page - 1)) == 0;
+  if (S_ISREG(s.st_mode) && aligned && pages > 0) {
+    void* addr = mmap(buffer + head, pages, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED, sys_fd, offset + head);
+    if (addr != MAP_FAILED) {
+      TRACE("  mapped %" PRId64 " bytes at 0x%08x\n", pages, static_cast<int32_t>(buf + head));
+      int64_t h = pread_fully(sys_fd, buffer, head, offset);
+      int64_t tail = len - head - pages;
+      int64_t t = pread_fully(sys_fd, buffer + head + pages, tail, offset + head + pages);
+      if (h < 0 || t < 0) { RETURN_MINUS_1; }
+      results[0] = wasm::Val::i32(static_cast<int32_t>(h + pages + t));
+      return nullptr;
+    }
+  }
+  int64_t result = pread_fully(sys_fd, buffer, len, offset);
+  results[0] = wasm::Val::i32(static_cast<int32_t>(result));
+  return nullptr;
+}
+
 WAVE_FUNC(fs_close) {
   instance_fds* fds = &global_fds;
   ARG(0, fd, i32);
@@ -315,6 +624,8 @@ int main(int argc, char* argv[]) {
     if (strncmp("--", arg, 2)) break;
     if (ARG_MATCH(arg, "trace")) {
       global_trace = true;
+    } else if (ARG_MATCH(arg, "no-cache")) {
+      global_cache = false;
     } else {
       ERROR("unrecognized option: %s\n", arg);
       return -1;
@@ -331,14 +642,8 @@ int main(int argc, char* argv[]) {
   }
 
   // Load binary.
-  std::ifstream file(global_filename);
-  file.seekg(0, std::ios_base::end);
-  auto file_size = file.tellg();
-  file.seekg(0);
-  auto binary = wasm::vec<byte_t>::make_uninitialized(file_size);
-  file.read(binary.get(), file_size);
-  file.close();
-  if (file.fail()) {
+  mapped_file binary;
+  if (!binary.map(global_filename)) {
     ERROR("could not load %s\n", global_filename);
     return -1;
   }
@@ -351,9 +656,9 @@ int main(int argc, char* argv[]) {
   // Initialize the file system.
   global_fds.clear();
 
-  // Compile.
-  TRACE("Compiling module...\n");
-  auto module = wasm::Module::make(store, binary);
+  // Compile, or load the compiled module from the cache.
+  auto module = load_module(store, binary);
+  binary.unmap();
   if (!module) {
     ERROR("could not compile %s\n", global_filename);
     return -1;
@@ -369,6 +674,7 @@ int main(int argc, char* argv[]) {
   auto v_i = F(V(), V(TI));
   auto i_v = F(V(TI), V());
   auto iiii_v = F(V(TI, TI, TI, TI), V());
+  auto iiii_i = F(V(TI, TI, TI, TI), V(TI));
 
 #define IMPORT_ENTRY(name, sig) {#name, sizeof(#name)-1, wave_##name, sig}
 
@@ -386,6 +692,11 @@ int main(int argc, char* argv[]) {
     IMPORT_ENTRY(fs_read, iii_i),
     IMPORT_ENTRY(fs_write, iii_i),
     IMPORT_ENTRY(fs_avail, i_i),
+    IMPORT_ENTRY(fs_readv, iii_i),
+    IMPORT_ENTRY(fs_writev, iii_i),
+    IMPORT_ENTRY(fs_pread, iiii_i),
+    IMPORT_ENTRY(fs_pwrite, iiii_i),
+    IMPORT_ENTRY(fs_mmap, iiii_i),
     IMPORT_ENTRY(fs_close, i_v),
     IMPORT_ENTRY(ticks_ms, v_i),
     IMPORT_ENTRY(ticks_us, v_i),
@@ -394,6 +705,11 @@ int main(int argc, char* argv[]) {
   };
 
   constexpr size_t num_import_entries = sizeof(import_entries) / sizeof(ImportEntry);
+  std::unordered_map<std::string, ImportEntry*> import_map;
+  for (size_t j = 0; j < num_import_entries; j++) {
+    auto entry = &import_entries[j];
+    import_map[std::string(entry->name, entry->name_len)] = entry;
+  }
 
   // Process imports of the module.
   TRACE("Processing imports...\n");
@@ -415,27 +731,21 @@ int main(int argc, char* argv[]) {
       ERROR("import[%zu] is not from \"wave\" module\n", i);
       return -1;
     }
-    bool found = false;
     auto func_type = imp->type()->func();
-    // XXX: linear search for each import. Replace with std::unordered_map ?
-    for (size_t j = 0; j < num_import_entries; j++) {
-      auto candidate = &import_entries[j];
-      if (!name_eq(candidate->name, candidate->name_len, n)) continue;
-      if (!sig_equal(candidate->sig.get(), func_type)) {
-        ERROR("import[%zu] of \"%s\" has unexpected signature\n", i, candidate->name);
-        return -1;
-      }
-
-      // Construct the imported function.
-      import_bindings[i] = wasm::Func::make(store, candidate->sig.get(), candidate->func);
-      found = true;
-      break;
-    }
-    if (!found) {
+    auto found = import_map.find(std::string(n.get(), n.size()));
+    if (found == import_map.end()) {
       ERROR("import[%zu] wave.\"%.*s\" not found\n",
-            i, static_cast<int>(m.size()), m.get());
+            i, static_cast<int>(n.size()), n.get());
       return -1;
     }
+    auto candidate = found->second;
+    if (!sig_equal(candidate->sig.get(), func_type)) {
+      ERROR("import[%zu] of \"%s\" has unexpected signature\n", i, candidate->name);
+      return -1;
+    }
+
+    // Construct the imported function.
+    import_bindings[i] = wasm::Func::make(store, candidate->sig.get(), candidate->func);
   }
 
   // Instantiate.
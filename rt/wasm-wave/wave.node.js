@@ -7,6 +7,15 @@ function extract_path(ptr, len) {
   return new util.TextDecoder().decode(new Uint8Array(memory.buffer, ptr, len));
 }
 
+function extract_iovs(ptr, len) {
+  var words = new DataView(memory.buffer, ptr, len * 8), iovs = [];
+  for (var i = 0; i < len; i++) {
+    var buf = words.getInt32(i * 8, true), buf_len = words.getInt32(i * 8 + 4, true);
+    iovs.push(new Uint8Array(memory.buffer, buf, buf_len));
+  }
+  return iovs;
+}
+
 const wave = {
   arg_len: (arg) => {
     return args[arg].length;
@@ -60,6 +69,48 @@ const wave = {
   fs_avail: (fd) => {
     // TODO
   },
+  fs_readv: (fd, iovs_ptr, iovs_len) => {
+    try {
+      return fs.readvSync(fd, extract_iovs(iovs_ptr, iovs_len), null);
+    } catch (e) {
+      return -1;
+    }
+  },
+  fs_writev: (fd, iovs_ptr, iovs_len) => {
+    try {
+      return fs.writevSync(fd, extract_iovs(iovs_ptr, iovs_len), null);
+    } catch (e) {
+      return -1;
+    }
+  },
+  fs_pread: (fd, buf_ptr, buf_len, offset) => {
+    try {
+      return fs.readSync(fd, memory, buf_ptr, buf_len, offset);
+    } catch (e) {
+      return -1;
+    }
+  },
+  fs_pwrite: (fd, buf_ptr, buf_len, offset) => {
+    try {
+      return fs.writeSync(fd, memory, buf_ptr, buf_len, offset);
+    } catch (e) {
+      return -1;
+    }
+  },
+  fs_mmap: (fd, buf_ptr, buf_len, offset) => {
+    // Node cannot map files into memory; read until the buffer is full or the file ends.
+    try {
+      var total = 0;
+      while (total < buf_len) {
+        var r = fs.readSync(fd, memory, buf_ptr + total, buf_len - total, offset + total);
+        if (r == 0) break;
+        total += r;
+      }
+      return total;
+    } catch (e) {
+      return -1;
+    }
+  },
   fs_close: (fd) => {
     fs.closeSync(fd);
   },
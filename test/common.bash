@@ -407,6 +407,7 @@ function execute_tests() {
     for target in $TEST_TARGETS; do
 	if [ "$target" = "v3i" ]; then
             (execute_v3i_tests "v3i" "") || exit $?
+            (execute_v3i_tests "v3i-tree" "-opt=-BytecodeInterp") || exit $?
             (execute_v3i_tests "v3i-ra" "-ra -ma=false") || exit $?
             (execute_v3i_tests "v3i-ra-ma" "-ra -ma=true") || exit $?
 #            (execute_v3i_tests "v3i-ra-wfts" "-ra -ma=false -wfts=true") || exit $?
@@ -89,6 +89,20 @@ function do_exe_test() {
     fail_fast
 }
 
+# Run the threaded runtime, which runs the parallel collector's workers on their own threads.
+function do_thread_test() {
+    local R=$VIRGIL_LOC/test/thread/$target
+    T=$OUT/$target
+    mkdir -p $T
+    print_status Threads "$target $V3C_OPTS"
+    run_v3c "" -stack-size=1m -heap-size=2m -symbols -target=$target -rt.gc -rt.gctables -rt.sttables -rt.tlab -rt.safepoints -runtime-code-size=16K -output=$T -program-name=RiThreadedRuntime \
+	$VIRGIL_LOC/rt/gc/*.v3 $VIRGIL_LOC/rt/native/NativeStack*.v3 $VIRGIL_LOC/rt/native/NativeGlobalsScanner.v3 $VIRGIL_LOC/rt/native/NativeFileStream.v3 \
+	$VIRGIL_LOC/rt/$target/*.v3 $VIRGIL_LOC/lib/asm/x86-64/*.v3 $VIRGIL_LOC/lib/util/*.v3 $VIRGIL_LOC/lib/$target/*.v3 $R/RiThreadedRuntime.v3 > $T/threads.out 2>&1 &&
+	$T/RiThreadedRuntime >> $T/threads.out 2>&1 &&
+	grep -q "^Hello World!$" $T/threads.out && ! grep -q "failed" $T/threads.out
+    check $? $T/threads.out
+}
+
 function get_target_tests() {
     TAGGED_REF64_PATTERN="taggedRef.*_64.v3"
     TAGGED_REF32_PATTERN="taggedRef.*_32.v3"
@@ -114,6 +128,27 @@ for target in $TEST_TARGETS; do
     is_gc_target $target && do_exe_test || do_nothing
 done
 
+# Run the execution tests again with the alternative collectors.
+BASE_OUT=$OUT
+BASE_V3C_OPTS=$V3C_OPTS
+for collector in generational parallel markcompact; do
+    case $collector in
+	parallel) opts="-redef-field=ParallelCopy.workers=4" ;;
+	*)        opts="-rt.collector=$collector" ;;
+    esac
+    OUT=$BASE_OUT/$collector
+    V3C_OPTS="$BASE_V3C_OPTS $opts"
+    for target in $TEST_TARGETS; do
+	get_target_tests
+	is_gc_target $target && do_exe_test || do_nothing
+	if [[ "$collector" = parallel && -d $VIRGIL_LOC/test/thread/$target ]]; then
+	    do_thread_test
+	fi
+    done
+done
+OUT=$BASE_OUT
+V3C_OPTS=$BASE_V3C_OPTS
+
 for target in $(get_io_targets); do
     get_target_tests 
     is_gc_target $target && do_int_test || do_nothing
@@ -22,6 +22,14 @@ function compile_target_tests_with_flags() {
             target_field="TARGET_${target//-/_}"
             FLAGS="$FLAGS -redef-field=${target_field}=true"
         fi
+        if [ -f $test.pgo ]; then
+            # profile a first build, then compile with the profile
+            P=$T/${base%.v3}.prof
+            rm -f $P
+            run_v3c $target $FLAGS -profile-gen=$P -output=$T $test &> $T/$base.gen.out && \
+                $CONFIG/run-$target $T $test &>> $T/$base.gen.out
+            FLAGS="$FLAGS -profile-use=$P"
+        fi
         run_v3c $target $FLAGS -output=$T $test &> $C
         trace_test_retval $?
     done
@@ -40,6 +48,48 @@ function run_reserved_code_test() {
     $T/reserved_code2
 }
 
+# TODO: profile mismatch test is special in that it compiles with another program's profile
+function run_pgo_mismatch_test() {
+    local P=$(ls $T/*.prof 2>/dev/null | head -1)
+    if [ -z "$P" ]; then
+        return 0
+    fi
+    trace_test_count 1
+    trace_test_start nop.v3
+    run_v3c $target -profile-use=$P -output=$T nop.v3 &> $T/pgo_mismatch.out
+    grep -q "Profile does not match program" $T/pgo_mismatch.out
+    trace_test_retval $? $T/pgo_mismatch.out
+}
+
+# compiles a copy of nop.v3 with -cache, expecting a hit ($1 = 1) or a miss ($1 = 0)
+function compile_cached() {
+    local expect=$1
+    shift
+    trace_test_start "cache$*"
+    rm -f $T/cache_nop
+    run_v3c $target -cache=$T/cache -output=$T "$@" $T/cache_nop.v3 &> $T/cache.out
+    local rv=$?
+    grep -q "restored from compile cache" $T/cache.out
+    if [[ $rv != 0 || $? != $((1 - expect)) || ! -x $T/cache_nop ]]; then
+        trace_test_fail $T/cache.out
+    else
+        trace_test_ok
+    fi
+}
+
+function run_compile_cache_test() {
+    rm -rf $T/cache
+    mkdir -p $T/cache
+    cp nop.v3 $T/cache_nop.v3
+    trace_test_count 5
+    compile_cached 0		# miss on an empty cache
+    compile_cached 1		# hit for the same compilation
+    compile_cached 0 -O2	# miss with different options
+    compile_cached 1 -O2
+    echo "// changed" >> $T/cache_nop.v3
+    compile_cached 0		# miss after the input changed
+}
+
 for target in $TEST_TARGETS; do
     T=$OUT/$target
     mkdir -p $T
@@ -54,5 +104,11 @@ for target in $TEST_TARGETS; do
 	print_status Running $target "reserved_code"
 	run_reserved_code_test | $PROGRESS
 	fail_fast
+	print_status Running $target "pgo_mismatch"
+	run_pgo_mismatch_test | $PROGRESS
+	fail_fast
+	print_status Running $target "compile_cache"
+	run_compile_cache_test | $PROGRESS
+	fail_fast
     fi
 done